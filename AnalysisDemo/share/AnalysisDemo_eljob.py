@@ -3,32 +3,132 @@
 # Copyright (C) 2002-2024 CERN for the benefit of the ATLAS collaboration
 #
 
-# Set up (Py)ROOT.
-import ROOT
-ROOT.xAOD.Init().ignore()
-
-# Set up the sample to run on.
+# System import(s).
+import argparse
+import glob
 import os
-sh = ROOT.SH.SampleHandler()
-sh.setMetaString('nc_tree', 'CollectionTree')
-sample = ROOT.SH.SampleLocal('MC')
-sample.add(os.getenv('ASG_TEST_FILE_MC'))
-sh.add(sample)
-
-# Create an EventLoop job.
-job = ROOT.EL.Job()
-job.sampleHandler(sh)
-
-# Create the main algorithm sequence, and add the demo algorithm sequence to it.
-from AnaAlgorithm.AlgSequence import AlgSequence
-from AnalysisDemo.AnalysisDemoSequence import makeAnalysisDemoSequence
-seq = AlgSequence()
-seq += makeAnalysisDemoSequence()
-
-# Add the sequence to the job.
-print(seq)
-seq.addSelfToJob(job)
-
-# Run the job locally.
-driver = ROOT.EL.LocalDriver()
-driver.submit(job, 'AnalysisDemo')
+import subprocess
+import sys
+
+def runJob(submitDir, skipEvents, maxEvents):
+    '''
+    Run the demo job in the current process, on (a range of) the input events.
+    '''
+
+    # Set up (Py)ROOT.
+    import ROOT
+    ROOT.xAOD.Init().ignore()
+
+    # Set up the sample to run on.
+    sh = ROOT.SH.SampleHandler()
+    sh.setMetaString('nc_tree', 'CollectionTree')
+    sample = ROOT.SH.SampleLocal('MC')
+    sample.add(os.getenv('ASG_TEST_FILE_MC'))
+    sh.add(sample)
+
+    # Create an EventLoop job.
+    job = ROOT.EL.Job()
+    job.sampleHandler(sh)
+    if skipEvents > 0:
+        job.options().setDouble(ROOT.EL.Job.optSkipEvents, skipEvents)
+    if maxEvents >= 0:
+        job.options().setDouble(ROOT.EL.Job.optMaxEvents, maxEvents)
+
+    # Create the main algorithm sequence, and add the demo algorithm sequence
+    # to it.
+    from AnaAlgorithm.AlgSequence import AlgSequence
+    from AnalysisDemo.AnalysisDemoSequence import makeAnalysisDemoSequence
+    seq = AlgSequence()
+    seq += makeAnalysisDemoSequence()
+
+    # Add the sequence to the job.
+    print(seq)
+    seq.addSelfToJob(job)
+
+    # Run the job locally.
+    driver = ROOT.EL.LocalDriver()
+    driver.submit(job, submitDir)
+
+def countEvents():
+    '''
+    Count the events in the input file(s) of the job.
+    '''
+
+    import ROOT
+    ifile = ROOT.TFile.Open(os.getenv('ASG_TEST_FILE_MC'))
+    return ifile.Get('CollectionTree').GetEntries()
+
+def runParallelJob(submitDir, nWorkers):
+    '''
+    Run the demo job in multiple processes, each one processing a separate
+    range of the input events, and merge their outputs at the end.
+    '''
+
+    # Split the input events between the workers. Only starting as many of
+    # them as are needed to process all events with the chosen shard size,
+    # so that none of them would receive an empty range.
+    os.makedirs(submitDir)
+    nEvents = countEvents()
+    if nEvents == 0:
+        print('No input events to process')
+        return
+    nWorkers = min(nWorkers, nEvents)
+    shardSize = (nEvents + nWorkers - 1) // nWorkers
+    nWorkers = (nEvents + shardSize - 1) // shardSize
+
+    # Launch the workers. They are started as new processes, instead of being
+    # forked from this one, so that each of them would set up ROOT and the
+    # ATLAS tools/algorithms independently of all the others.
+    workers = []
+    for i in range(nWorkers):
+        workerDir = os.path.join(submitDir, 'worker_%i' % i)
+        logFile = open(os.path.join(submitDir, 'worker_%i.log' % i), 'w')
+        command = [sys.executable, os.path.abspath(__file__),
+                   '--submit-dir', workerDir,
+                   '--skip-events', str(i * shardSize),
+                   '--max-events', str(shardSize)]
+        workers.append((subprocess.Popen(command, stdout=logFile,
+                                         stderr=subprocess.STDOUT),
+                        logFile))
+
+    # Wait for all of them to finish.
+    failed = []
+    for worker, logFile in workers:
+        if worker.wait() != 0:
+            failed.append(logFile.name)
+        logFile.close()
+    if failed:
+        raise RuntimeError('Failed worker(s), see: %s' % ', '.join(failed))
+
+    # Merge the outputs of the workers.
+    outputs = {}
+    for i in range(nWorkers):
+        workerDir = os.path.join(submitDir, 'worker_%i' % i)
+        for output in glob.glob(os.path.join(workerDir, '*.root')):
+            outputs.setdefault(os.path.basename(output), []).append(output)
+    for name, inputs in outputs.items():
+        subprocess.check_call(['hadd', '-f', os.path.join(submitDir, name)] +
+                              inputs)
+
+def main():
+
+    # Parse the command line arguments.
+    parser = argparse.ArgumentParser(description='EventLoop demo job')
+    parser.add_argument('--submit-dir', default='AnalysisDemo',
+                        help='Submission directory for EventLoop')
+    parser.add_argument('--parallel', type=int, default=1,
+                        help='Number of local worker processes to use')
+    parser.add_argument('--skip-events', type=int, default=0,
+                        help=argparse.SUPPRESS)
+    parser.add_argument('--max-events', type=int, default=-1,
+                        help=argparse.SUPPRESS)
+    args = parser.parse_args()
+
+    # Run the job.
+    if args.parallel > 1:
+        runParallelJob(args.submit_dir, args.parallel)
+    else:
+        runJob(args.submit_dir, args.skip_events, args.max_events)
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,493 @@
+// Copyright (C) 2002-2024 CERN for the benefit of the ATLAS collaboration
+
+// Local include(s).
+#include "MuonAnalysisTools/MuonCalibrator.h"
+#include "MuonAnalysisTools/MuonVariationCodec.h"
+
+// Framework include(s).
+#include <AsgMessaging/MessageCheck.h>
+#include <PATInterfaces/SystematicSet.h>
+#include <PATInterfaces/SystematicVariation.h>
+
+// ROOT include(s).
+#include <TBranch.h>
+#include <TFile.h>
+#include <TList.h>
+#include <TParameter.h>
+#include <TROOT.h>
+#include <TTree.h>
+
+// System include(s).
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/// Calibrated pt written for muons outside of the calibration's validity range
+constexpr float INVALID_PT = -1.f;
+
+/// Muon properties of all events in a single TTree cluster, flattened
+struct MuonBatch {
+    /// Offsets of the events' muons in the flat arrays (size: nEvents + 1)
+    std::vector<std::size_t> offsets;
+    /// Uncalibrated transverse momenta
+    std::vector<float> pt;
+    /// Pseudorapidities
+    std::vector<float> eta;
+    /// Azimuthal angles
+    std::vector<float> phi;
+    /// Calibrated transverse momenta, one array per output column
+    std::vector<std::vector<float> > calibratedPt;
+    /// Delta-encoded systematic variations, one array per systematic column
+    std::vector<std::vector<ATE::MuonVariationCodec::value_type> > encodedPt;
+};  // struct MuonBatch
+
+/// Simple bounded, closeable queue connecting the stages of the pipeline
+template <typename T>
+class BoundedQueue {
+
+public:
+    /// Constructor with the maximal number of elements to hold
+    explicit BoundedQueue(std::size_t capacity) : m_capacity(capacity) {}
+
+    /// Add an element to the queue, waiting for free space if necessary
+    ///
+    /// @return @c false if the queue was closed, @c true otherwise
+    ///
+    bool push(T value) {
+        std::unique_lock lock{m_mutex};
+        m_notFull.wait(lock, [this]() {
+            return (m_queue.size() < m_capacity) || m_closed;
+        });
+        if (m_closed) {
+            return false;
+        }
+        m_queue.push(std::move(value));
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    /// Get an element from the queue, or nothing if the queue was closed
+    std::optional<T> pop() {
+        std::unique_lock lock{m_mutex};
+        m_notEmpty.wait(lock,
+                        [this]() { return (!m_queue.empty()) || m_closed; });
+        if (m_queue.empty()) {
+            return std::nullopt;
+        }
+        T result = std::move(m_queue.front());
+        m_queue.pop();
+        m_notFull.notify_one();
+        return result;
+    }
+
+    /// Signal that no more elements will be pushed into the queue
+    void close() {
+        std::lock_guard lock{m_mutex};
+        m_closed = true;
+        m_notEmpty.notify_all();
+        m_notFull.notify_all();
+    }
+
+private:
+    /// The maximal number of elements in the queue
+    std::size_t m_capacity;
+    /// The elements in the queue
+    std::queue<T> m_queue;
+    /// Flag showing whether the queue was closed
+    bool m_closed = false;
+    /// Mutex protecting the queue
+    std::mutex m_mutex;
+    /// Condition signalling that the queue is not empty anymore
+    std::condition_variable m_notEmpty;
+    /// Condition signalling that the queue is not full anymore
+    std::condition_variable m_notFull;
+};  // class BoundedQueue
+
+/// Configuration of the job, as received from the command line
+struct Config {
+    /// The input file name
+    std::string inputFile;
+    /// The output file name
+    std::string outputFile;
+    /// The name of the input and output trees
+    std::string treeName = "analysis";
+    /// The name of the input muon pt branch
+    std::string ptBranch = "muon_pt";
+    /// The name of the input muon eta branch
+    std::string etaBranch = "muon_eta";
+    /// The name of the input muon phi branch
+    std::string phiBranch = "muon_phi";
+    /// The name of the (nominal) output column
+    std::string outputColumn = "muon_pt_calib";
+    /// Systematic variations to write out
+    std::vector<std::string> systematics;
+    /// Write out all recommended systematic variations
+    bool allSystematics = false;
+    /// Precision of the delta-encoded systematic columns (0: no encoding)
+    float deltaPrecision = 0.f;
+    /// Number of ROOT implicit MT threads to use (for the output compression)
+    unsigned int nThreads = 0;
+    /// Number of clusters allowed in flight between pipeline stages
+    std::size_t queueDepth = 4;
+};  // struct Config
+
+/// Print the usage of the executable
+void printUsage(const char* exe) {
+
+    std::cout
+        << "Usage: " << exe << " [options] <input file> <output file>\n\n"
+        << "Options:\n"
+        << "  --tree <name>           Input/output tree name [analysis]\n"
+        << "  --pt <branch>           Input muon pt branch [muon_pt]\n"
+        << "  --eta <branch>          Input muon eta branch [muon_eta]\n"
+        << "  --phi <branch>          Input muon phi branch [muon_phi]\n"
+        << "  --output <column>       Output column name [muon_pt_calib]\n"
+        << "  --syst <name>           Systematic variation to write (can be\n"
+        << "                          given multiple times)\n"
+        << "  --all-systematics       Write all recommended systematics\n"
+        << "  --delta-precision <p>   Store systematic columns as int16\n"
+        << "                          relative differences from nominal,\n"
+        << "                          in units of <p> (e.g. 0.001)\n"
+        << "  --threads <n>           ROOT implicit MT threads for the\n"
+        << "                          output compression [0: disabled]\n"
+        << "  --queue-depth <n>       Clusters in flight per stage [4]\n"
+        << std::endl;
+}
+
+/// Parse the command line arguments
+bool parseArguments(int argc, char* argv[], Config& config) {
+
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto value = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+        if (arg == "--tree") {
+            config.treeName = value();
+        } else if (arg == "--pt") {
+            config.ptBranch = value();
+        } else if (arg == "--eta") {
+            config.etaBranch = value();
+        } else if (arg == "--phi") {
+            config.phiBranch = value();
+        } else if (arg == "--output") {
+            config.outputColumn = value();
+        } else if (arg == "--syst") {
+            config.systematics.push_back(value());
+        } else if (arg == "--all-systematics") {
+            config.allSystematics = true;
+        } else if (arg == "--delta-precision") {
+            config.deltaPrecision = std::stof(value());
+        } else if (arg == "--threads") {
+            config.nThreads = std::stoul(value());
+        } else if (arg == "--queue-depth") {
+            config.queueDepth = std::max<std::size_t>(1, std::stoul(value()));
+        } else if ((arg == "-h") || (arg == "--help")) {
+            return false;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() != 2) {
+        return false;
+    }
+    config.inputFile = positional[0];
+    config.outputFile = positional[1];
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+
+    // Set up the environment.
+    using namespace asg::msgUserCode;
+    ANA_CHECK_SET_TYPE(int);
+
+    // Interpret the command line arguments.
+    Config config;
+    try {
+        if (!parseArguments(argc, argv, config)) {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    } catch (const std::exception& ex) {
+        ANA_MSG_ERROR(ex.what());
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    // The input and the output files are accessed from different threads
+    // concurrently, so ROOT's thread safety needs to be enabled in any case.
+    ROOT::EnableThreadSafety();
+    if (config.nThreads > 0) {
+        ROOT::EnableImplicitMT(config.nThreads);
+    }
+
+    // Set up the muon calibrator.
+    ATE::MuonCalibrator calibrator;
+    ANA_CHECK(calibrator.initialize());
+
+    // Set up the encoding of the systematic columns, if requested.
+    std::optional<ATE::MuonVariationCodec> codec;
+    if (config.deltaPrecision != 0.f) {
+        try {
+            codec.emplace(config.deltaPrecision);
+        } catch (const std::exception& ex) {
+            ANA_MSG_ERROR(ex.what());
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Collect the systematic variations to write out. The first column is
+    // always the nominal calibration.
+    std::vector<CP::SystematicSet> systematics;
+    std::vector<std::string> columns{config.outputColumn};
+    if (config.allSystematics) {
+        for (const CP::SystematicVariation& var :
+             calibrator.recommendedSystematics()) {
+            config.systematics.push_back(var.name());
+        }
+    }
+    const CP::SystematicSet affecting = calibrator.affectingSystematics();
+    for (const std::string& name : config.systematics) {
+        const CP::SystematicVariation var{name};
+        if (affecting.find(var) == affecting.end()) {
+            ANA_MSG_ERROR("Systematic variation \"" << name
+                                                    << "\" does not affect "
+                                                       "the muon calibration");
+            return EXIT_FAILURE;
+        }
+        systematics.push_back(CP::SystematicSet{var});
+        columns.push_back(config.outputColumn + "_" + name);
+    }
+
+    // Open the input file, and set up reading only the branches that we need.
+    std::unique_ptr<TFile> ifile{TFile::Open(config.inputFile.c_str())};
+    if ((!ifile) || ifile->IsZombie()) {
+        ANA_MSG_ERROR("Couldn't open input file: " << config.inputFile);
+        return EXIT_FAILURE;
+    }
+    TTree* itree = ifile->Get<TTree>(config.treeName.c_str());
+    if (itree == nullptr) {
+        ANA_MSG_ERROR("Couldn't find tree \"" << config.treeName << "\" in "
+                                              << config.inputFile);
+        return EXIT_FAILURE;
+    }
+    std::vector<float>* ptIn = nullptr;
+    std::vector<float>* etaIn = nullptr;
+    std::vector<float>* phiIn = nullptr;
+    TBranch* ptBranch = nullptr;
+    TBranch* etaBranch = nullptr;
+    TBranch* phiBranch = nullptr;
+    itree->SetBranchStatus("*", 0);
+    for (const std::string& name :
+         {config.ptBranch, config.etaBranch, config.phiBranch}) {
+        itree->SetBranchStatus(name.c_str(), 1);
+    }
+    if ((itree->SetBranchAddress(config.ptBranch.c_str(), &ptIn, &ptBranch) <
+         0) ||
+        (itree->SetBranchAddress(config.etaBranch.c_str(), &etaIn,
+                                 &etaBranch) < 0) ||
+        (itree->SetBranchAddress(config.phiBranch.c_str(), &phiIn,
+                                 &phiBranch) < 0)) {
+        ANA_MSG_ERROR("Couldn't connect to the input muon branches");
+        return EXIT_FAILURE;
+    }
+    // Only the three muon branches are ever read, so there's no need for the
+    // cache to go through a learning phase.
+    itree->SetCacheSize(-1);
+    itree->AddBranchToCache(ptBranch);
+    itree->AddBranchToCache(etaBranch);
+    itree->AddBranchToCache(phiBranch);
+    itree->StopCacheLearningPhase();
+
+    // Set up the output file. The output tree is meant to be used as a friend
+    // of the input one, so it only holds the new columns.
+    std::unique_ptr<TFile> ofile{
+        TFile::Open(config.outputFile.c_str(), "RECREATE")};
+    if ((!ofile) || ofile->IsZombie()) {
+        ANA_MSG_ERROR("Couldn't open output file: " << config.outputFile);
+        return EXIT_FAILURE;
+    }
+    auto otree =
+        std::make_unique<TTree>(config.treeName.c_str(), "Calibrated muons");
+    otree->SetDirectory(ofile.get());
+    // With delta-encoding the systematic columns get a "_delta" postfix, and
+    // the precision of the encoding is stored in the tree's user info, for
+    // ATE::RDF::DefineDecodedVariations to set up the decoding with.
+    std::vector<std::vector<float> > outputs(codec ? 1 : columns.size());
+    for (std::size_t i = 0; i < outputs.size(); ++i) {
+        otree->Branch(columns[i].c_str(), &(outputs[i]));
+    }
+    std::vector<std::vector<ATE::MuonVariationCodec::value_type> >
+        encodedOutputs(codec ? columns.size() - 1 : 0);
+    for (std::size_t i = 0; i < encodedOutputs.size(); ++i) {
+        otree->Branch((columns[i + 1] + "_delta").c_str(),
+                      &(encodedOutputs[i]));
+    }
+    if (codec) {
+        otree->GetUserInfo()->Add(new TParameter<float>(
+            (config.outputColumn + "_delta_precision").c_str(),
+            codec->precision()));
+    }
+
+    // The queues connecting the stages of the pipeline.
+    BoundedQueue<MuonBatch> readQueue{config.queueDepth};
+    BoundedQueue<MuonBatch> calibQueue{config.queueDepth};
+
+    // Exception(s) thrown by the helper threads.
+    std::exception_ptr readError, calibError;
+    // Number of muons outside of the calibration's validity range.
+    std::size_t nInvalidMuons = 0;
+
+    // Reader stage: read one cluster at a time into a flat batch.
+    std::thread reader{[&]() {
+        try {
+            const Long64_t nEntries = itree->GetEntries();
+            auto clusters = itree->GetClusterIterator(0);
+            for (Long64_t start = clusters(); start < nEntries;
+                 start = clusters()) {
+                const Long64_t end =
+                    std::min(clusters.GetNextEntry(), nEntries);
+                MuonBatch batch;
+                batch.offsets.reserve(end - start + 1);
+                batch.offsets.push_back(0);
+                for (Long64_t entry = start; entry < end; ++entry) {
+                    const Long64_t local = itree->LoadTree(entry);
+                    if ((ptBranch->GetEntry(local) <= 0) ||
+                        (etaBranch->GetEntry(local) <= 0) ||
+                        (phiBranch->GetEntry(local) <= 0)) {
+                        throw std::runtime_error(
+                            "Failed to read entry " + std::to_string(entry));
+                    }
+                    if ((ptIn->size() != etaIn->size()) ||
+                        (ptIn->size() != phiIn->size())) {
+                        throw std::invalid_argument(
+                            "Muon vectors have different sizes in entry " +
+                            std::to_string(entry));
+                    }
+                    batch.pt.insert(batch.pt.end(), ptIn->begin(),
+                                    ptIn->end());
+                    batch.eta.insert(batch.eta.end(), etaIn->begin(),
+                                     etaIn->end());
+                    batch.phi.insert(batch.phi.end(), phiIn->begin(),
+                                     phiIn->end());
+                    batch.offsets.push_back(batch.pt.size());
+                }
+                if (!readQueue.push(std::move(batch))) {
+                    break;
+                }
+            }
+        } catch (...) {
+            readError = std::current_exception();
+            calibQueue.close();
+        }
+        readQueue.close();
+    }};
+
+    // Calibration stage: calibrate a whole cluster, with the nominal and all
+    // systematic variations evaluated in a single pass over its muons. Muons
+    // outside of the validity range get INVALID_PT, and are only counted.
+    std::thread calibration{[&]() {
+        try {
+            while (auto batch = readQueue.pop()) {
+                batch->calibratedPt.resize(columns.size());
+                std::vector<std::span<float> > results;
+                for (std::vector<float>& result : batch->calibratedPt) {
+                    result.resize(batch->pt.size());
+                    results.push_back(result);
+                }
+                nInvalidMuons += calibrator.getCalibratedPtVariations(
+                    batch->pt, batch->eta, batch->phi, systematics, results,
+                    INVALID_PT);
+                if (codec) {
+                    batch->encodedPt.resize(columns.size() - 1);
+                    for (std::size_t i = 1; i < columns.size(); ++i) {
+                        batch->encodedPt[i - 1].resize(batch->pt.size());
+                        codec->encode(batch->calibratedPt[0],
+                                      batch->calibratedPt[i],
+                                      batch->encodedPt[i - 1]);
+                    }
+                }
+                if (!calibQueue.push(std::move(*batch))) {
+                    break;
+                }
+            }
+        } catch (...) {
+            calibError = std::current_exception();
+            readQueue.close();
+        }
+        calibQueue.close();
+    }};
+
+    // Writer stage, running in the main thread.
+    Long64_t nEvents = 0;
+    std::size_t nMuons = 0;
+    while (auto batch = calibQueue.pop()) {
+        const std::size_t nBatchEvents = batch->offsets.size() - 1;
+        for (std::size_t event = 0; event < nBatchEvents; ++event) {
+            const std::size_t begin = batch->offsets[event];
+            const std::size_t end = batch->offsets[event + 1];
+            for (std::size_t i = 0; i < outputs.size(); ++i) {
+                outputs[i].assign(batch->calibratedPt[i].begin() + begin,
+                                  batch->calibratedPt[i].begin() + end);
+            }
+            for (std::size_t i = 0; i < encodedOutputs.size(); ++i) {
+                encodedOutputs[i].assign(batch->encodedPt[i].begin() + begin,
+                                         batch->encodedPt[i].begin() + end);
+            }
+            otree->Fill();
+        }
+        nEvents += nBatchEvents;
+        nMuons += batch->pt.size();
+    }
+    reader.join();
+    calibration.join();
+
+    // Check whether any of the stages failed.
+    for (const std::exception_ptr& error : {readError, calibError}) {
+        if (error) {
+            try {
+                std::rethrow_exception(error);
+            } catch (const std::exception& ex) {
+                ANA_MSG_ERROR("Failed to process the input: " << ex.what());
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    // Write out the output tree.
+    ofile->cd();
+    otree->Write();
+    otree.release();
+    ofile->Close();
+    ANA_MSG_INFO("Calibrated " << nMuons << " muons in " << nEvents
+                               << " events into " << config.outputFile);
+    if (nInvalidMuons > 0) {
+        ANA_MSG_WARNING(nInvalidMuons
+                        << " muons were outside of the validity range of the "
+                           "calibration, and got a calibrated pt of "
+                        << INVALID_PT);
+    }
+
+    // Return gracefully.
+    return EXIT_SUCCESS;
+}
@@ -2,6 +2,7 @@
 
 // Local include(s).
 #include "MuonAnalysisTools/MuonCalibratorRDF.h"
+#include "RDFProfiler.h"
 
 // Framework include(s).
 #include <AsgMessaging/MessageCheck.h>
@@ -10,99 +11,240 @@
 
 // ROOT include(s).
 #include <TCanvas.h>
+#include <TEnv.h>
+#include <TFile.h>
+#include <TH1D.h>
 #include <TROOT.h>
 #include <TString.h>
 #include <TSystem.h>
+#include <TTree.h>
+#include <TTreeCache.h>
 
 #include <ROOT/RDFHelpers.hxx>
+#include <ROOT/RDataFrame.hxx>
 
 // System include(s).
+#include <algorithm>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
-int main() {
+namespace {
+
+/// Find the branch holding an auxiliary variable of a container
+///
+/// Depending on how the file was written, the variable may either be stored
+/// as a dynamic variable, or as a (split) member of the static auxiliary
+/// container.
+///
+std::string auxBranchName(TTree& tree, const std::string& container,
+                          const std::string& variable) {
+
+    for (const std::string& name : {container + "AuxDyn." + variable,
+                                    container + "Aux." + variable}) {
+        if (tree.GetBranch(name.c_str()) != nullptr) {
+            return name;
+        }
+    }
+    throw std::runtime_error("Couldn't find a branch for " + container +
+                             "." + variable);
+}
+
+/// Create a data frame that only reads the muon variables of the calibration
+///
+/// Instead of reading the full muon interface and auxiliary containers
+/// through the xAOD data source, this data frame reads the pt, eta and phi
+/// auxiliary variables directly from the input tree. Only those branches get
+/// read, decompressed and cached, and the data frame provides them as the
+/// "muon_pt", "muon_eta" and "muon_phi" columns.
+///
+/// RDataFrame reads the input through its own trees, one per task, so their
+/// read cache can only be tuned through process-wide settings. Which this
+/// function only touches if @c tuneReadCache is set.
+///
+ROOT::RDF::RNode makePrunedDataFrame(const std::string& fileName,
+                                     const std::string& container,
+                                     bool tuneReadCache) {
+
+    // Look up the names of the branches to read.
+    static const char* const treeName = "CollectionTree";
+    std::unique_ptr<TFile> file{TFile::Open(fileName.c_str())};
+    if ((!file) || file->IsZombie()) {
+        throw std::runtime_error("Couldn't open input file: " + fileName);
+    }
+    TTree* tree = file->Get<TTree>(treeName);
+    if (tree == nullptr) {
+        throw std::runtime_error("Couldn't find " + std::string{treeName} +
+                                 " in: " + fileName);
+    }
+    const std::string ptBranch = auxBranchName(*tree, container, "pt");
+    const std::string etaBranch = auxBranchName(*tree, container, "eta");
+    const std::string phiBranch = auxBranchName(*tree, container, "phi");
+
+    // Tune the read cache for the three muon branches, if requested. Its
+    // default size is meant for all branches of a cluster, so it is scaled
+    // down to the share of those three branches (with a bit of a margin for
+    // baskets not aligned with the clusters). RDataFrame only reads the
+    // branches of the used columns, which are exactly these three, so the
+    // cache only needs to observe a single entry to learn which branches to
+    // prefetch.
+    if (tuneReadCache) {
+        Long64_t muonBytes = 0;
+        for (const std::string& name : {ptBranch, etaBranch, phiBranch}) {
+            muonBytes += tree->GetBranch(name.c_str())->GetZipBytes();
+        }
+        const double cacheFactor =
+            std::min(1., 1.2 * muonBytes / tree->GetZipBytes());
+        gEnv->SetValue("TTreeCache.Size", cacheFactor);
+        TTreeCache::SetLearnEntries(1);
+    }
+
+    // Create the data frame.
+    ROOT::RDataFrame df{treeName, fileName};
+    return df.Alias("muon_pt", ptBranch)
+        .Alias("muon_eta", etaBranch)
+        .Alias("muon_phi", phiBranch);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
 
     // Set up the environment.
     using namespace asg::msgUserCode;
     ANA_CHECK_SET_TYPE(int);
+
+    // Interpret the command line arguments.
+    bool profile = false;
+    bool pruned = false;
+    std::uint64_t progressInterval = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--profile") == 0) {
+            profile = true;
+        } else if (std::strcmp(argv[i], "--pruned") == 0) {
+            pruned = true;
+        } else if ((std::strcmp(argv[i], "--progress") == 0) &&
+                   (i + 1 < argc)) {
+            progressInterval = std::stoull(argv[++i]);
+        } else {
+            std::cout << "Usage: " << argv[0]
+                      << " [--profile] [--progress <events per thread>]"
+                      << " [--pruned]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
     ANA_CHECK(xAOD::Init());
     ROOT::EnableImplicitMT();
 
-    // Create a data frame object.
-    auto df = xAOD::MakeDataFrame(gSystem->Getenv("ASG_TEST_FILE_MC"));
+    // Create a data frame object. Either one reading the full xAOD muon
+    // containers, or one reading just the muon variables used by the
+    // calibration. This job reads nothing else, so the read cache is tuned
+    // for just those variables in the latter case.
+    const std::string fileName = gSystem->Getenv("ASG_TEST_FILE_MC");
+    ROOT::RDF::RNode df =
+        pruned ? makePrunedDataFrame(fileName, "Muons", true)
+               : ROOT::RDF::RNode{xAOD::MakeDataFrame(fileName)};
+
+    // Set up the (optional) profiling of the job.
+    ATE::RDFProfiler profiler{profile, progressInterval};
 
-    // Create the muon calibrator object(s).
-    ATE::RDF::MuonCalibratorxAOD muCalibxAOD;
-    ANA_CHECK(muCalibxAOD.initialize());
-    ATE::RDF::MuonCalibrator muCalib;
+    // Create the muon calibrator object. It produces both the nominal and the
+    // systematically varied muon momenta in a single pass.
+    ATE::RDF::MuonCalibratorVariator muCalib;
     ANA_CHECK(muCalib.initialize());
 
-    // Create the muon "variator" object(s).
-    ATE::RDF::MuonVariatorxAOD muVarxAOD;
-    ANA_CHECK(muVarxAOD.initialize());
-    ATE::RDF::MuonVariator muVar;
-    ANA_CHECK(muVar.initialize());
+    // The histograms to draw.
+    std::vector<ROOT::RDF::Experimental::RResultMap<TH1D> > hists;
 
-    // Create the calibrated muon pt as a new column, from the xAOD container.
-    auto muon_pt_xaod = df.Define("muon_pt_calib", muCalibxAOD, {"Muons"})
-                            .Vary("muon_pt_calib", muVarxAOD, {"Muons"},
-                                  {"foo_up", "foo_down"});
+    // The primitive columns, to create the calibrated muon pt from.
+    ROOT::RDF::RNode muon_primitive = df;
+
+    if (!pruned) {
+        // Create the calibrated muon pt as a new column, from the xAOD
+        // container.
+        ATE::RDF::MuonCalibratorVariatorxAOD muCalibxAOD;
+        ANA_CHECK(muCalibxAOD.initialize());
+        auto muon_pt_xaod = ATE::RDF::DefineCalibratedPt(
+            df, "muon_pt_calib",
+            profiler.wrap("calibration+variations (xAOD)", muCalibxAOD),
+            {"Muons"}, {"foo_up", "foo_down"});
+        hists.push_back(ROOT::RDF::Experimental::VariationsFor(
+            muon_pt_xaod.Histo1D("muon_pt_calib")));
+
+        // Set up the primitive columns from the xAOD container.
+        auto muon_eta = [](const xAOD::MuonContainer& muons) {
+            std::vector<float> result;
+            result.reserve(muons.size());
+            for (const xAOD::Muon* muon : muons) {
+                result.push_back(muon->eta());
+            }
+            return result;
+        };
+        auto muon_phi = [](const xAOD::MuonContainer& muons) {
+            std::vector<float> result;
+            result.reserve(muons.size());
+            for (const xAOD::Muon* muon : muons) {
+                result.push_back(muon->phi());
+            }
+            return result;
+        };
+        auto muon_pt = [](const xAOD::MuonContainer& muons) {
+            std::vector<float> result;
+            result.reserve(muons.size());
+            for (const xAOD::Muon* muon : muons) {
+                result.push_back(muon->pt());
+            }
+            return result;
+        };
+        muon_primitive =
+            df.Define("muon_eta",
+                      profiler.wrap("column extraction", muon_eta), {"Muons"})
+                .Define("muon_phi",
+                        profiler.wrap("column extraction", muon_phi),
+                        {"Muons"})
+                .Define("muon_pt", profiler.wrap("column extraction", muon_pt),
+                        {"Muons"});
+    }
 
     // Create the calibrated muon pt as a new column, from primitive columns.
-    // For this, first set up the primitive columns from the xAOD container.
-    auto muon_primitive = df.Define("muon_eta",
-                                    [](const xAOD::MuonContainer& muons) {
-                                        std::vector<float> result;
-                                        result.reserve(muons.size());
-                                        for (const xAOD::Muon* muon : muons) {
-                                            result.push_back(muon->eta());
-                                        }
-                                        return result;
-                                    },
-                                    {"Muons"})
-                              .Define("muon_phi",
-                                      [](const xAOD::MuonContainer& muons) {
-                                          std::vector<float> result;
-                                          result.reserve(muons.size());
-                                          for (const xAOD::Muon* muon : muons) {
-                                              result.push_back(muon->phi());
-                                          }
-                                          return result;
-                                      },
-                                      {"Muons"})
-                              .Define("muon_pt",
-                                      [](const xAOD::MuonContainer& muons) {
-                                          std::vector<float> result;
-                                          result.reserve(muons.size());
-                                          for (const xAOD::Muon* muon : muons) {
-                                              result.push_back(muon->pt());
-                                          }
-                                          return result;
-                                      },
-                                      {"Muons"});
-
-    // Now create the calibrated column.
-    auto muon_pt_primitive =
-        muon_primitive
-            .Define("muon_pt_calib", muCalib,
-                    {"muon_pt", "muon_eta", "muon_phi"})
-            .Vary("muon_pt_calib", muVar, {"muon_pt", "muon_eta", "muon_phi"},
-                  {"foo_up", "foo_down"});
+    auto muon_pt_primitive = ATE::RDF::DefineCalibratedPt(
+        muon_primitive, "muon_pt_calib",
+        profiler.wrap("calibration+variations", muCalib),
+        {"muon_pt", "muon_eta", "muon_phi"}, {"foo_up", "foo_down"});
+
+    // Book all of the results before triggering the event loop, so that all
+    // of them would be produced by a single pass over the input.
+    auto count = df.Count();
+    if (progressInterval > 0) {
+        count.OnPartialResultSlot(
+            progressInterval, [&profiler](unsigned int, ULong64_t&) {
+                profiler.eventsProcessed(profiler.progressInterval());
+            });
+    }
+    hists.push_back(ROOT::RDF::Experimental::VariationsFor(
+        muon_pt_primitive.Histo1D("muon_pt_calib")));
+
+    // Run the event loop, and print the profiling results, if requested.
+    profiler.eventLoopStarted();
+    const ULong64_t nEvents = *count;
+    profiler.eventLoopFinished();
+    profiler.report(nEvents);
 
     // Make a histogram of the calibrated muon pts.
     TCanvas canvas{"canvas", "canvas", 1600, 600};
-    canvas.Divide(2);
-    canvas.cd(1)->SetLogy();
-    auto hist1 = muon_pt_xaod.Histo1D("muon_pt_calib");
-    auto hist1_var = ROOT::RDF::Experimental::VariationsFor(hist1);
-    hist1_var["nominal"].Draw();
-    hist1_var["muon_pt_calib:foo_up"].Draw("SAME");
-    hist1_var["muon_pt_calib:foo_down"].Draw("SAME");
-    canvas.cd(2)->SetLogy();
-    auto hist2 = muon_pt_primitive.Histo1D("muon_pt_calib");
-    auto hist2_var = ROOT::RDF::Experimental::VariationsFor(hist2);
-    hist2_var["nominal"].Draw();
-    hist2_var["muon_pt_calib:foo_up"].Draw("SAME");
-    hist2_var["muon_pt_calib:foo_down"].Draw("SAME");
+    canvas.Divide(hists.size());
+    for (std::size_t i = 0; i < hists.size(); ++i) {
+        canvas.cd(i + 1)->SetLogy();
+        hists[i]["nominal"].Draw();
+        hists[i]["muon_pt_calib:foo_up"].Draw("SAME");
+        hists[i]["muon_pt_calib:foo_down"].Draw("SAME");
+    }
     canvas.SaveAs("muon_pt.png");
 
     // Return gracefully.
@@ -0,0 +1,152 @@
+// Copyright (C) 2002-2024 CERN for the benefit of the ATLAS collaboration
+
+// Local include(s).
+#include "RDFProfiler.h"
+
+// System include(s).
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+
+namespace {
+
+/// Counter used to give a unique identifier to every profiler
+std::atomic<std::size_t> s_profilerCounter{0};
+
+/// Convert a duration to seconds
+double toSeconds(std::chrono::steady_clock::duration d) {
+    return std::chrono::duration<double>(d).count();
+}
+
+}  // namespace
+
+namespace ATE {
+
+RDFProfiler::RDFProfiler(bool enabled, std::uint64_t progressInterval,
+                         const std::string& name)
+    : asg::AsgMessaging(name),
+      m_enabled(enabled),
+      m_progressInterval(progressInterval),
+      m_id(s_profilerCounter++),
+      m_start(std::chrono::steady_clock::now()),
+      m_stop(m_start) {}
+
+void RDFProfiler::eventLoopStarted() {
+
+    m_start = std::chrono::steady_clock::now();
+}
+
+void RDFProfiler::eventLoopFinished() {
+
+    m_stop = std::chrono::steady_clock::now();
+}
+
+void RDFProfiler::eventsProcessed(std::uint64_t nEvents) {
+
+    // Update the counter.
+    const std::uint64_t processed = (m_processed += nEvents);
+
+    // Print the progress.
+    const double elapsed =
+        toSeconds(std::chrono::steady_clock::now() - m_start);
+    std::lock_guard lock{m_mutex};
+    ATH_MSG_INFO("Processed " << processed << " events in " << std::fixed
+                              << std::setprecision(1) << elapsed << " s ("
+                              << processed / elapsed << " events/s)");
+}
+
+void RDFProfiler::report(std::uint64_t nEvents) const {
+
+    // Don't do anything if profiling was not enabled.
+    if (!m_enabled) {
+        return;
+    }
+
+    // Collect the per-stage and per-thread statistics.
+    const double wallTime = toSeconds(m_stop - m_start);
+    std::lock_guard lock{m_mutex};
+    std::vector<StageStats> stages(m_stages.size());
+    std::vector<double> threadTimes;
+    for (const std::unique_ptr<ThreadStats>& thread : m_threads) {
+        std::chrono::steady_clock::duration threadTime{};
+        for (std::size_t i = 0; i < thread->stages.size(); ++i) {
+            stages[i].time += thread->stages[i].time;
+            stages[i].calls += thread->stages[i].calls;
+            threadTime += thread->stages[i].time;
+        }
+        threadTimes.push_back(toSeconds(threadTime));
+    }
+
+    // Print the overall throughput.
+    ATH_MSG_INFO("Event loop processed "
+                 << nEvents << " events in " << std::fixed
+                 << std::setprecision(2) << wallTime << " s ("
+                 << std::setprecision(1) << nEvents / wallTime << " events/s)");
+
+    // Print the time spent in the individual stages.
+    std::ostringstream table;
+    table << std::fixed << std::setprecision(3);
+    table << "\n  " << std::left << std::setw(30) << "Stage" << std::right
+          << std::setw(12) << "Calls" << std::setw(12) << "Time [s]"
+          << std::setw(14) << "Per call [us]";
+    double stageTotal = 0.;
+    for (std::size_t i = 0; i < stages.size(); ++i) {
+        const double time = toSeconds(stages[i].time);
+        stageTotal += time;
+        table << "\n  " << std::left << std::setw(30) << m_stages[i]
+              << std::right << std::setw(12) << stages[i].calls
+              << std::setw(12) << time << std::setw(14)
+              << (stages[i].calls ? 1e6 * time / stages[i].calls : 0.);
+    }
+    ATH_MSG_INFO("Time spent in the profiled stages:" << table.str());
+    ATH_MSG_INFO("Time spent outside of the profiled stages (input reading, "
+                 "histogram filling, framework): "
+                 << std::fixed << std::setprecision(3)
+                 << std::max(0., wallTime * std::max<std::size_t>(
+                                                1, threadTimes.size()) -
+                                     stageTotal)
+                 << " s (summed over all threads)");
+
+    // Print the load balance between the threads.
+    std::ostringstream balance;
+    balance << std::fixed << std::setprecision(3);
+    for (std::size_t i = 0; i < threadTimes.size(); ++i) {
+        balance << "\n  Thread " << std::setw(3) << i << ": "
+                << std::setw(10) << threadTimes[i] << " s ("
+                << std::setprecision(1) << std::setw(5)
+                << 100. * threadTimes[i] / wallTime << "% busy)"
+                << std::setprecision(3);
+    }
+    ATH_MSG_INFO("Time spent in the profiled stages per thread:"
+                 << balance.str());
+}
+
+std::size_t RDFProfiler::stageIndex(const std::string& stage) {
+
+    auto itr = std::find(m_stages.begin(), m_stages.end(), stage);
+    if (itr != m_stages.end()) {
+        return itr - m_stages.begin();
+    }
+    m_stages.push_back(stage);
+    return m_stages.size() - 1;
+}
+
+RDFProfiler::ThreadStats& RDFProfiler::threadStats() const {
+
+    // Look for the statistics of the current thread in a thread-local cache
+    // first, to only lock the mutex the first time that a thread would need
+    // them.
+    thread_local std::unordered_map<std::size_t, ThreadStats*> cache;
+    auto itr = cache.find(m_id);
+    if (itr != cache.end()) {
+        return *(itr->second);
+    }
+    std::lock_guard lock{m_mutex};
+    m_threads.push_back(std::make_unique<ThreadStats>());
+    m_threads.back()->stages.resize(m_stages.size());
+    cache[m_id] = m_threads.back().get();
+    return *(m_threads.back());
+}
+
+}  // namespace ATE
@@ -0,0 +1,143 @@
+// Copyright (C) 2002-2024 CERN for the benefit of the ATLAS collaboration
+#ifndef ANALYSISDEMO_UTILS_RDFPROFILER_H
+#define ANALYSISDEMO_UTILS_RDFPROFILER_H
+
+// Framework include(s).
+#include <AsgMessaging/AsgMessaging.h>
+
+// System include(s).
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ATE {
+
+/// Helper for profiling the stages of a @c ROOT::RDataFrame based job
+///
+/// Callables given to @c ROOT::RDataFrame::Define or @c ROOT::RDataFrame::Vary
+/// can be wrapped with @c ATE::RDFProfiler::wrap. The wrapped callables keep
+/// the exact signature of the original ones, so RDataFrame can still deduce
+/// their argument and return types. When profiling is enabled, the time spent
+/// in every stage is accumulated separately by each thread, and summarized by
+/// @c ATE::RDFProfiler::report at the end of the job.
+///
+/// The throughput and load balance figures are calculated for the period
+/// between the @c ATE::RDFProfiler::eventLoopStarted and
+/// @c ATE::RDFProfiler::eventLoopFinished calls, which should enclose just
+/// the event loop of the job.
+///
+class RDFProfiler : public asg::AsgMessaging {
+
+public:
+    /// Constructor
+    RDFProfiler(bool enabled, std::uint64_t progressInterval = 0,
+                const std::string& name = "ATE::RDFProfiler");
+
+    /// Wrap a callable, to measure the time spent in it
+    ///
+    /// @param stage The name of the stage that the callable belongs to
+    /// @param func The callable to wrap
+    /// @return A callable with the same signature as @c func
+    ///
+    template <typename FUNC>
+    auto wrap(const std::string& stage, FUNC func) {
+        return wrapImpl(stageIndex(stage), std::move(func), &FUNC::operator());
+    }
+
+    /// Signal that a number of events were processed (by any thread)
+    ///
+    /// Meant to be called from a @c ROOT::RDF::RResultPtr::OnPartialResultSlot
+    /// callback, every @c progressInterval() events per slot.
+    ///
+    void eventsProcessed(std::uint64_t nEvents);
+
+    /// Signal that the event loop is about to start
+    void eventLoopStarted();
+    /// Signal that the event loop has finished
+    void eventLoopFinished();
+
+    /// Get the number of events after which each slot should report progress
+    std::uint64_t progressInterval() const { return m_progressInterval; }
+
+    /// Print a summary of the collected timing information
+    void report(std::uint64_t nEvents) const;
+
+private:
+    /// Timing information collected for one stage in one thread
+    struct StageStats {
+        /// Time spent in the stage
+        std::chrono::steady_clock::duration time{};
+        /// Number of calls to the stage
+        std::uint64_t calls = 0;
+    };  // struct StageStats
+
+    /// Timing information collected by one thread
+    struct ThreadStats {
+        /// Timing information for each of the stages
+        std::vector<StageStats> stages;
+    };  // struct ThreadStats
+
+    /// Get the index of a (possibly new) stage
+    std::size_t stageIndex(const std::string& stage);
+    /// Get the timing information of the current thread
+    ThreadStats& threadStats() const;
+
+    /// Implementation of the wrapping for const callables
+    template <typename FUNC, typename CLASS, typename RESULT, typename... ARGS>
+    auto wrapImpl(std::size_t stage, FUNC func,
+                  RESULT (CLASS::*)(ARGS...) const) {
+        return [this, stage, func = std::move(func)](ARGS... args) -> RESULT {
+            if (!m_enabled) {
+                return func(std::forward<ARGS>(args)...);
+            }
+            const auto start = std::chrono::steady_clock::now();
+            // Make sure that the time is accounted for even if the callable
+            // throws an exception.
+            struct Recorder {
+                StageStats& stats;
+                std::chrono::steady_clock::time_point start;
+                ~Recorder() {
+                    stats.time += std::chrono::steady_clock::now() - start;
+                    ++stats.calls;
+                }
+            };
+            ThreadStats& tstats = threadStats();
+            if (tstats.stages.size() <= stage) {
+                tstats.stages.resize(stage + 1);
+            }
+            Recorder recorder{tstats.stages[stage], start};
+            return func(std::forward<ARGS>(args)...);
+        };
+    }
+
+    /// Flag for whether profiling is enabled
+    bool m_enabled;
+    /// Number of events after which each slot reports progress (0: never)
+    std::uint64_t m_progressInterval;
+    /// Unique identifier of this object, for the thread-local lookup(s)
+    std::size_t m_id;
+    /// Start time of the event loop
+    std::chrono::steady_clock::time_point m_start;
+    /// End time of the event loop
+    std::chrono::steady_clock::time_point m_stop;
+
+    /// Names of the stages
+    std::vector<std::string> m_stages;
+    /// Timing information from the threads that executed any of the stages
+    mutable std::vector<std::unique_ptr<ThreadStats> > m_threads;
+    /// Mutex protecting @c m_threads and the progress printouts
+    mutable std::mutex m_mutex;
+    /// Number of processed events, as reported by @c eventsProcessed
+    std::atomic<std::uint64_t> m_processed{0};
+
+};  // class RDFProfiler
+
+}  // namespace ATE
+
+#endif  // ANALYSISDEMO_UTILS_RDFPROFILER_H
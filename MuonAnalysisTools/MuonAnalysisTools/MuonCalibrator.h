@@ -9,7 +9,12 @@
 #include <PATInterfaces/SystematicVariation.h>
 
 // System include(s).
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
 #include <string>
+#include <vector>
 
 namespace ATE {
 
@@ -61,6 +66,98 @@ public:
     float getCalibratedPt(float pt, float eta, float phi,
                           const CP::SystematicSet& syst = {}) const;
 
+    /// Get the calibrated transverse momentum of a muon, without throwing
+    ///
+    /// Unlike @c getCalibratedPt, it signals muons outside of the validity
+    /// range of the calibration through its return value, instead of an
+    /// exception. Making it suitable for code that would routinely encounter
+    /// such muons.
+    ///
+    /// @param pt The uncalibrated transverse momentum of the muon
+    /// @param eta The pseudorapidity of the muon
+    /// @param phi The azimuthal angle of the muon
+    /// @param result The calibrated transverse momentum of the muon
+    /// @param syst The systematic variation(s) to apply
+    /// @return @c true if the muon could be calibrated, @c false if it is
+    ///         outside of the validity range (leaving @c result unchanged)
+    ///
+    bool tryGetCalibratedPt(float pt, float eta, float phi, float& result,
+                            const CP::SystematicSet& syst = {}) const;
+
+    /// Get the calibrated transverse momenta of a batch of muons
+    ///
+    /// The systematic variation(s) are only resolved once for the entire
+    /// batch, making this function much cheaper per muon than calling the
+    /// single-muon overload in a loop.
+    ///
+    /// @param pt The uncalibrated transverse momenta of the muons
+    /// @param eta The pseudorapidities of the muons
+    /// @param phi The azimuthal angles of the muons
+    /// @param result The calibrated transverse momenta of the muons
+    /// @param syst The systematic variation(s) to apply
+    ///
+    void getCalibratedPt(std::span<const float> pt, std::span<const float> eta,
+                         std::span<const float> phi, std::span<float> result,
+                         const CP::SystematicSet& syst = {}) const;
+
+    /// Get toy variations of the calibrated transverse momentum of a muon
+    ///
+    /// In every toy, the variation of every bin of every systematic source
+    /// gets scaled by an independent, standard normal random number. These
+    /// numbers come from a counter-based generator, keyed by the seed, the
+    /// bin and the toy index. So a given toy is fully reproducible, without
+    /// having to store anything for it.
+    ///
+    /// @param pt The uncalibrated transverse momentum of the muon
+    /// @param eta The pseudorapidity of the muon
+    /// @param phi The azimuthal angle of the muon
+    /// @param seed The seed of the toy generation
+    /// @param result The calibrated transverse momenta, one for each toy
+    ///
+    void getToyCalibratedPt(float pt, float eta, float phi,
+                            std::uint32_t seed,
+                            std::span<float> result) const;
+
+    /// Get the nominal and all recommended variations of a calibrated muon
+    ///
+    /// The nominal calibration is only evaluated once, and all of the
+    /// systematic variations are derived from it.
+    ///
+    /// @param pt The uncalibrated transverse momentum of the muon
+    /// @param eta The pseudorapidity of the muon
+    /// @param phi The azimuthal angle of the muon
+    /// @param result The nominal calibrated transverse momentum, followed by
+    ///               the ones for each of the recommended systematics
+    ///
+    void getCalibratedPtVariations(float pt, float eta, float phi,
+                                   std::span<float> result) const;
+
+    /// Get the nominal and some variations of a batch of calibrated muons
+    ///
+    /// The systematic variation(s) are only resolved once for the entire
+    /// batch, and the nominal calibration of every muon is only evaluated
+    /// once, with all of the requested variations derived from it.
+    ///
+    /// Muons outside of the validity range of the calibration do not cause
+    /// an exception. They receive @c invalidPt in all of the outputs instead,
+    /// and are counted in the return value.
+    ///
+    /// @param pt The uncalibrated transverse momenta of the muons
+    /// @param eta The pseudorapidities of the muons
+    /// @param phi The azimuthal angles of the muons
+    /// @param syst The systematic variations to evaluate
+    /// @param result The nominal calibrated transverse momenta of the muons,
+    ///               followed by the ones for each of the variations in
+    ///               @c syst
+    /// @param invalidPt The value to use for muons outside of the validity
+    ///                  range
+    /// @return The number of muons outside of the validity range
+    ///
+    std::size_t getCalibratedPtVariations(
+        std::span<const float> pt, std::span<const float> eta,
+        std::span<const float> phi, const std::vector<CP::SystematicSet>& syst,
+        std::span<const std::span<float> > result, float invalidPt) const;
+
 protected:
     /// List of all affecting systematics
     std::vector<CP::SystematicVariation> m_affectingSystematics;
@@ -79,6 +176,42 @@ private:
         float variation = 0.f;
     };  // struct CalibData
 
+    /// A single calibration step to apply to a muon
+    struct CalibStep {
+        /// The calibration data to use
+        std::vector<CalibData> MuonCalibrator::*calibs = nullptr;
+        /// The direction in which to apply the variation
+        float sign = 1.f;
+    };  // struct CalibStep
+
+    /// All calibration steps to apply for a given systematic variation
+    struct CalibSteps {
+        /// The calibration steps, in the order that they need to be applied
+        std::array<CalibStep, 5> steps;
+        /// The number of valid steps in @c steps
+        std::size_t size = 0;
+    };  // struct CalibSteps
+
+    /// Get phi into the [-pi, pi) range
+    static float wrapPhi(float phi);
+    /// Index returned by @c tryFindCalib for muons not in any bin
+    static constexpr std::size_t INVALID_BIN = static_cast<std::size_t>(-1);
+    /// Find the index of the calibration bin that a muon falls into
+    static std::size_t findCalib(const std::vector<CalibData>& calibs,
+                                 float pt, float eta, float phi);
+    /// Find the index of the calibration bin of a muon, without throwing
+    static std::size_t tryFindCalib(const std::vector<CalibData>& calibs,
+                                    float pt, float eta, float phi);
+    /// Collect the calibration steps needed for a systematic variation
+    CalibSteps calibSteps(const CP::SystematicSet& syst,
+                          bool nominal = true) const;
+    /// Apply a set of calibration steps to a single muon
+    float applyCalibSteps(float pt, float eta, float phi,
+                          const CalibSteps& steps) const;
+    /// Apply a set of calibration steps to a single muon, without throwing
+    bool tryApplyCalibSteps(float& pt, float eta, float phi,
+                            const CalibSteps& steps) const;
+
     /// Nominal calibration data
     std::vector<CalibData> m_nominal;
     /// Calibration data for the "MUON_FOO" systematic variation
@@ -86,6 +219,10 @@ private:
     /// Calibration data for the "MUON_BAR" systematic variation
     std::vector<CalibData> m_bar;
 
+    /// Calibration steps (on top of the nominal calibration) for each of the
+    /// recommended systematic variations
+    std::vector<CalibSteps> m_recommendedSteps;
+
     /// The name of the object. Needed to be able to copy the tool properly.
     std::string m_name;
 
@@ -4,14 +4,19 @@
 
 // Local include(s).
 #include "MuonAnalysisTools/MuonCalibrator.h"
+#include "MuonAnalysisTools/MuonVariationCodec.h"
 
 // EDM include(s).
 #include <xAODMuon/MuonContainer.h>
 
 // ROOT include(s).
+#include <ROOT/RDataFrame.hxx>
 #include <ROOT/RVec.hxx>
+class TTree;
 
 // System include(s).
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -70,6 +75,180 @@ public:
 
 };  // class MuonVariatorxAOD
 
+/// Functor calibrating muons with all their recommended variations at once
+///
+/// The result holds the nominal calibrated transverse momenta as its first
+/// element, followed by the ones for each recommended systematic variation.
+/// It is meant to be used through @c ATE::RDF::DefineCalibratedPt.
+///
+class MuonCalibratorVariator : public ATE::MuonCalibrator {
+
+public:
+    // Inherit the base class's constructor(s).
+    using ATE::MuonCalibrator::MuonCalibrator;
+
+    /// Operator calibrating the muons of a single event
+    ROOT::RVec<std::vector<float> > operator()(
+        const std::vector<float>& pt, const std::vector<float>& eta,
+        const std::vector<float>& phi) const;
+
+};  // class MuonCalibratorVariator
+
+/// Functor calibrating muons with all their recommended variations at once,
+/// on an xAOD
+class MuonCalibratorVariatorxAOD : public ATE::MuonCalibrator {
+
+public:
+    // Inherit the base class's constructor(s).
+    using ATE::MuonCalibrator::MuonCalibrator;
+
+    /// Operator calibrating the muons of a single event
+    ROOT::RVec<std::vector<float> > operator()(
+        const xAOD::MuonContainer& muons) const;
+
+};  // class MuonCalibratorVariatorxAOD
+
+/// Define a calibrated muon pt column together with its variations
+///
+/// The calibration is performed just once per event, into a helper column.
+/// Both the nominal column and its variations are taken from that helper
+/// column, which RDataFrame evaluates only once per event in every slot.
+///
+/// @param node The RDataFrame node to define the column on
+/// @param column The name of the calibrated muon pt column
+/// @param calibrator A @c MuonCalibratorVariator(xAOD) (like) callable
+/// @param inputs The input column(s) of @c calibrator
+/// @param variationTags The tags of the recommended systematic variations
+/// @return The RDataFrame node with the new column
+///
+template <typename NODE, typename CALIBRATOR>
+auto DefineCalibratedPt(NODE node, const std::string& column,
+                        CALIBRATOR calibrator,
+                        const std::vector<std::string>& inputs,
+                        const std::vector<std::string>& variationTags) {
+
+    const std::string helper = column + "_all_variations";
+    return node.Define(helper, std::move(calibrator), inputs)
+        .Define(column,
+                [](const ROOT::RVec<std::vector<float> >& pts) {
+                    return pts[0];
+                },
+                {helper})
+        .Vary(column,
+              [](const ROOT::RVec<std::vector<float> >& pts) {
+                  return ROOT::RVec<std::vector<float> >(pts.begin() + 1,
+                                                         pts.end());
+              },
+              {helper}, variationTags);
+}
+
+/// Functor producing toy variations with @c ROOT::RDataFrame::Vary
+///
+/// Meant to be used with the overload of @c ROOT::RDataFrame::Vary that
+/// receives the number of variations, instead of their names.
+///
+class MuonToyVariator : public ATE::MuonCalibrator {
+
+public:
+    /// Constructor with the number of toys and the seed to generate them with
+    MuonToyVariator(std::size_t nToys, std::uint32_t seed = 0,
+                    const std::string& name = "ATE::RDF::MuonToyVariator");
+
+    /// Operator producing the toy variations for the muons of an event
+    ROOT::RVec<std::vector<float> > operator()(
+        const std::vector<float>& pt, const std::vector<float>& eta,
+        const std::vector<float>& phi) const;
+
+private:
+    /// The number of toys to generate
+    std::size_t m_nToys;
+    /// The seed of the toy generation
+    std::uint32_t m_seed;
+
+};  // class MuonToyVariator
+
+/// Functor producing toy variations with @c ROOT::RDataFrame::Vary, on an xAOD
+class MuonToyVariatorxAOD : public ATE::MuonCalibrator {
+
+public:
+    /// Constructor with the number of toys and the seed to generate them with
+    MuonToyVariatorxAOD(
+        std::size_t nToys, std::uint32_t seed = 0,
+        const std::string& name = "ATE::RDF::MuonToyVariatorxAOD");
+
+    /// Operator producing the toy variations for the muons of an event
+    ROOT::RVec<std::vector<float> > operator()(
+        const xAOD::MuonContainer& muons) const;
+
+private:
+    /// The number of toys to generate
+    std::size_t m_nToys;
+    /// The seed of the toy generation
+    std::uint32_t m_seed;
+
+};  // class MuonToyVariatorxAOD
+
+/// Functor decoding a varied column, for use with @c ROOT::RDataFrame::Define
+class MuonVariationDecoder : public ATE::MuonVariationCodec {
+
+public:
+    // Inherit the base class's constructor(s).
+    using ATE::MuonVariationCodec::MuonVariationCodec;
+
+    /// Operator decoding the variation of the muons of a single event
+    std::vector<float> operator()(const std::vector<float>& nominal,
+                                  const std::vector<value_type>& delta) const;
+
+};  // class MuonVariationDecoder
+
+/// Delta-encoded variations of a column, as found in a tree
+struct EncodedVariations {
+    /// The precision that the variations were encoded with
+    float precision = 0.f;
+    /// The names of the encoded variations
+    std::vector<std::string> names;
+};  // struct EncodedVariations
+
+/// Find the delta-encoded variations of a column in a tree
+///
+/// The variations are expected in "<column>_<variation>_delta" branches, with
+/// the precision of their encoding stored as a @c TParameter<float> called
+/// "<column>_delta_precision" in the user info of the tree. Which is how
+/// @c AnalysisDemo_ntuple writes them.
+///
+/// @param tree The tree holding the encoded variations
+/// @param column The name of the nominal column
+/// @return The precision and the names of the encoded variations
+///
+EncodedVariations findEncodedVariations(TTree& tree, const std::string& column);
+
+/// Define the decoded variations of a delta-encoded column
+///
+/// Defines a "<column>_<variation>" column for each of the variations found
+/// by @c findEncodedVariations, holding the decoded transverse momenta. So
+/// that the rest of the analysis would see the same columns as if the
+/// variations were written without encoding.
+///
+/// @param node The RDataFrame node to define the columns on
+/// @param tree The tree holding the encoded variations (for instance a friend
+///             of the tree processed by @c node)
+/// @param column The name of the nominal column
+/// @return The RDataFrame node with the decoded columns
+///
+template <typename NODE>
+ROOT::RDF::RNode DefineDecodedVariations(NODE node, TTree& tree,
+                                         const std::string& column) {
+
+    const EncodedVariations variations = findEncodedVariations(tree, column);
+    const MuonVariationDecoder decoder{variations.precision};
+    ROOT::RDF::RNode result = node;
+    for (const std::string& name : variations.names) {
+        result = result.Define(column + "_" + name, decoder,
+                               {column, column + "_" + name + "_delta"});
+    }
+    return result;
+}
+
 }  // namespace ATE::RDF
 
 #endif  // MUONANALYSISTOOLS_MUONCALIBRATORRDF_H
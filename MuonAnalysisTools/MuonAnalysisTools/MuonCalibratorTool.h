@@ -8,12 +8,20 @@
 
 // Framework include(s).
 #include <AsgTools/AsgTool.h>
+#include <AsgTools/PropertyWrapper.h>
 #include <PATInterfaces/ISystematicsTool.h>
 #include <PATInterfaces/SystematicSet.h>
 #include <PATInterfaces/SystematicsTool.h>
 
 // System include(s).
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace ATE {
 
@@ -28,12 +36,24 @@ public:
 
     /// Constructor for standalone usage
     MuonCalibratorTool(const std::string &name);
+#ifdef XAOD_STANDALONE
+    /// Destructor, printing a summary of the out-of-validity muons
+    ///
+    /// Standalone tools are not finalized, so this is the only place where
+    /// the summary can be printed for them.
+    ///
+    ~MuonCalibratorTool();
+#endif  // XAOD_STANDALONE
 
     /// @name Functions implementing @c asg::AsgTool functions
     /// @{
 
     /// Initialize the tool
     StatusCode initialize() override;
+#ifndef XAOD_STANDALONE
+    /// Finalize the tool, printing a summary of the out-of-validity muons
+    StatusCode finalize() override;
+#endif  // not XAOD_STANDALONE
 
     /// @}
 
@@ -58,6 +78,51 @@ private:
 
     /// @}
 
+    /// @name Out-of-validity muon bookkeeping
+    /// @{
+
+    /// Number of pseudorapidity regions used in the bookkeeping
+    static constexpr std::size_t N_ETA_REGIONS = 6;
+    /// Number of azimuthal angle regions used in the bookkeeping
+    static constexpr std::size_t N_PHI_REGIONS = 4;
+    /// Number of transverse momentum regions used in the bookkeeping
+    static constexpr std::size_t N_PT_REGIONS = 5;
+
+    /// Counts of out-of-validity muons, collected by a single thread
+    struct OutOfValidityCounts {
+        /// Number of muons in each of the (eta, phi, pt) regions
+        std::array<std::uint64_t,
+                   N_ETA_REGIONS * N_PHI_REGIONS * N_PT_REGIONS>
+            counts{};
+    };  // struct OutOfValidityCounts
+
+    /// Record a muon that is outside of the validity range of the tool
+    void recordOutOfValidity(const xAOD::Muon &muon) const;
+    /// Get the out-of-validity counts of the current thread
+    OutOfValidityCounts &outOfValidityCounts() const;
+    /// Print a summary of all out-of-validity muons encountered (only once)
+    void printOutOfValiditySummary() const;
+
+    /// Maximum number of out-of-validity muons to print detailed warnings for
+    Gaudi::Property<unsigned int> m_maxDetailedWarnings{
+        this, "MaxDetailedWarnings", 10,
+        "Maximum number of out-of-validity muons to warn about individually"};
+
+    /// Unique identifier of this object, for the thread-local lookup(s)
+    std::size_t m_id;
+    /// Number of detailed out-of-validity warnings printed so far
+    mutable std::atomic<unsigned int> m_nDetailedWarnings{0};
+    /// Out-of-validity counts from every thread that encountered any
+    mutable std::vector<std::unique_ptr<OutOfValidityCounts> >
+        m_outOfValidityCounts;
+    /// Flag showing whether the out-of-validity summary was printed already
+    mutable bool m_outOfValiditySummaryPrinted = false;
+    /// Mutex protecting @c m_outOfValidityCounts and
+    /// @c m_outOfValiditySummaryPrinted
+    mutable std::mutex m_outOfValidityMutex;
+
+    /// @}
+
     /// The active systematic variation(s) to apply
     CP::SystematicSet m_syst;
     /// Tool performing the actual calibration
@@ -0,0 +1,64 @@
+// Copyright (C) 2002-2024 CERN for the benefit of the ATLAS collaboration
+#ifndef MUONANALYSISTOOLS_MUONVARIATIONCODEC_H
+#define MUONANALYSISTOOLS_MUONVARIATIONCODEC_H
+
+// System include(s).
+#include <cstdint>
+#include <span>
+
+namespace ATE {
+
+/// Compact encoding of systematically varied muon momenta
+///
+/// Systematic variations of the calibrated muon momenta usually only differ
+/// from the nominal values by a small relative amount. So instead of storing
+/// them as full floats, this class stores them as the relative difference
+/// with respect to the nominal value, quantized to a 16-bit integer in units
+/// of a configurable precision. (1 per mille by default.)
+///
+/// The quantization error of a decoded value is at most half of the precision
+/// times the nominal value, i.e. |decoded - varied| <= precision / 2 *
+/// |nominal|, up to float rounding. Relative to the varied value itself, it
+/// is at most precision / (2 * (1 + r)), with r = varied / nominal - 1. So it
+/// slightly exceeds half of the precision for downward variations.
+///
+class MuonVariationCodec {
+
+public:
+    /// The type used to store the encoded variations
+    using value_type = std::int16_t;
+
+    /// Constructor with the precision (unit) of the relative differences
+    explicit MuonVariationCodec(float precision = 1e-3f);
+
+    /// Get the precision (unit) of the relative differences
+    float precision() const { return m_precision; }
+
+    /// Encode systematically varied transverse momenta
+    ///
+    /// @param nominal The nominal transverse momenta
+    /// @param varied The systematically varied transverse momenta
+    /// @param delta The encoded relative differences
+    ///
+    void encode(std::span<const float> nominal, std::span<const float> varied,
+                std::span<value_type> delta) const;
+
+    /// Decode systematically varied transverse momenta
+    ///
+    /// @param nominal The nominal transverse momenta
+    /// @param delta The encoded relative differences
+    /// @param varied The decoded, systematically varied transverse momenta
+    ///
+    void decode(std::span<const float> nominal,
+                std::span<const value_type> delta,
+                std::span<float> varied) const;
+
+private:
+    /// The precision (unit) of the relative differences
+    float m_precision;
+
+};  // class MuonVariationCodec
+
+}  // namespace ATE
+
+#endif  // MUONANALYSISTOOLS_MUONVARIATIONCODEC_H
@@ -6,5 +6,6 @@
 #include "MuonAnalysisTools/MuonCalibrator.h"
 #include "MuonAnalysisTools/MuonCalibratorRDF.h"
 #include "MuonAnalysisTools/MuonCalibratorTool.h"
+#include "MuonAnalysisTools/MuonVariationCodec.h"
 
 #endif  // MUONANALYSISTOOLS_MUONANALYSISTOOLSDICT_H
@@ -4,9 +4,80 @@
 #include "MuonAnalysisTools/MuonCalibrator.h"
 
 // System include(s).
+#include <algorithm>
+#include <bit>
 #include <cmath>
 #include <stdexcept>
 
+namespace {
+
+/// Bit mixing function (the finalizer of MurmurHash3) for the toy generation
+///
+/// Being a bijection on 32-bit integers, it gives a different value for every
+/// counter value that it would receive.
+///
+inline std::uint32_t mixBits(std::uint32_t h) {
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+/// Natural logarithm of a positive, normal number
+///
+/// Unlike @c std::log or @c vdt::fast_logf, it does not have any branches for
+/// special values, so loops calling it can be vectorized. Its relative error
+/// is about 1e-7.
+///
+inline float logPositive(float x) {
+
+    // Split the number into an exponent, and a mantissa in
+    // [sqrt(1/2), sqrt(2)).
+    const std::uint32_t bits = std::bit_cast<std::uint32_t>(x) - 0x3f3504f3u;
+    const float e = static_cast<float>(static_cast<std::int32_t>(bits) >> 23);
+    const float m =
+        std::bit_cast<float>((bits & 0x007fffffu) + 0x3f3504f3u) - 1.f;
+    // Evaluate log(1 + m) with the Cephes polynomial.
+    float p = 7.0376836292e-2f;
+    p = p * m - 1.1514610310e-1f;
+    p = p * m + 1.1676998740e-1f;
+    p = p * m - 1.2420140846e-1f;
+    p = p * m + 1.4249322787e-1f;
+    p = p * m - 1.6668057665e-1f;
+    p = p * m + 2.0000714765e-1f;
+    p = p * m - 2.4999993993e-1f;
+    p = p * m + 3.3333331174e-1f;
+    return m + m * m * (m * p - 0.5f) + e * 0.693147180559945f;
+}
+
+/// Cosine of 2*pi*u, for u in [0, 1]
+///
+/// Like @c logPositive, it does not have any branches, and its absolute error
+/// is about 2e-7.
+///
+inline float cos2Pi(float u) {
+
+    // Reduce the argument to [0, pi/2], using the symmetries of the cosine.
+    const float a = std::abs(u - 0.5f);
+    const float sign = (a < 0.25f) ? -1.f : 1.f;
+    const float x = 2.f * float(M_PI) * std::min(a, 0.5f - a);
+    // Evaluate the Taylor series of the cosine, which is precise enough in
+    // this range.
+    const float x2 = x * x;
+    float p = 1.f / 479001600.f;
+    p = p * x2 - 1.f / 3628800.f;
+    p = p * x2 + 1.f / 40320.f;
+    p = p * x2 - 1.f / 720.f;
+    p = p * x2 + 1.f / 24.f;
+    p = p * x2 - 0.5f;
+    return sign * (1.f + x2 * p);
+}
+
+}  // namespace
+
 namespace ATE {
 
 MuonCalibrator::MuonCalibrator(const std::string& name)
@@ -18,7 +89,8 @@ MuonCalibrator::MuonCalibrator(const MuonCalibrator& parent)
       m_recommendedSystematics(parent.m_recommendedSystematics),
       m_nominal(parent.m_nominal),
       m_foo(parent.m_foo),
-      m_bar(parent.m_bar) {}
+      m_bar(parent.m_bar),
+      m_recommendedSteps(parent.m_recommendedSteps) {}
 
 MuonCalibrator::MuonCalibrator(MuonCalibrator&& parent)
     : asg::AsgMessaging(parent.m_name),
@@ -26,7 +98,8 @@ MuonCalibrator::MuonCalibrator(MuonCalibrator&& parent)
       m_recommendedSystematics(std::move(parent.m_recommendedSystematics)),
       m_nominal(std::move(parent.m_nominal)),
       m_foo(std::move(parent.m_foo)),
-      m_bar(std::move(parent.m_bar)) {}
+      m_bar(std::move(parent.m_bar)),
+      m_recommendedSteps(std::move(parent.m_recommendedSteps)) {}
 
 StatusCode MuonCalibrator::initialize() {
 
@@ -39,7 +112,11 @@ StatusCode MuonCalibrator::initialize() {
     m_affectingSystematics.insert(m_affectingSystematics.end(),
                                   {{"MUON_BAR", 1}, {"MUON_BAR", -1}});
 
-    // Set up the calibration data.
+    // Set up the calibration data. Making sure that initializing the object
+    // more than once would not duplicate any of it.
+    m_nominal.clear();
+    m_foo.clear();
+    m_bar.clear();
     m_nominal.push_back({-5.f, 5.f, -M_PI, M_PI, 0.f, 1e10f, 0.f});
 
     m_foo.push_back({-5.f, 0.f, -M_PI, M_PI, 0.f, 1e5f, 0.1f});
@@ -49,6 +126,12 @@ StatusCode MuonCalibrator::initialize() {
     m_bar.push_back({-5.f, 5.f, -M_PI, M_PI, 0.f, 1e5f, 0.1f});
     m_bar.push_back({-5.f, 5.f, -M_PI, M_PI, 0.f, 1e10f, 0.2f});
 
+    // Pre-compute the calibration steps of the recommended systematics.
+    m_recommendedSteps.clear();
+    for (const CP::SystematicVariation& syst : m_recommendedSystematics) {
+        m_recommendedSteps.push_back(calibSteps({syst}, false));
+    }
+
     // Return gracefully.
     return StatusCode::SUCCESS;
 }
@@ -66,64 +149,246 @@ CP::SystematicSet MuonCalibrator::recommendedSystematics() const {
 float MuonCalibrator::getCalibratedPt(float pt, float eta, float phi,
                                       const CP::SystematicSet& syst) const {
 
-    // Get phi into the -pi to pi range. Apparently reconstructed muons still
-    // have values outside of it sometimes. :-/
-    while (phi < -M_PI) {
-        phi += 2.f * M_PI;
+    return applyCalibSteps(pt, eta, phi, calibSteps(syst));
+}
+
+bool MuonCalibrator::tryGetCalibratedPt(float pt, float eta, float phi,
+                                        float& result,
+                                        const CP::SystematicSet& syst) const {
+
+    if (!tryApplyCalibSteps(pt, eta, phi, calibSteps(syst))) {
+        return false;
     }
-    while (phi >= M_PI) {
-        phi -= 2.f * M_PI;
+    result = pt;
+    return true;
+}
+
+void MuonCalibrator::getCalibratedPt(std::span<const float> pt,
+                                     std::span<const float> eta,
+                                     std::span<const float> phi,
+                                     std::span<float> result,
+                                     const CP::SystematicSet& syst) const {
+
+    // Do some sanity checks.
+    if ((pt.size() != eta.size()) || (pt.size() != phi.size()) ||
+        (pt.size() != result.size())) {
+        throw std::invalid_argument("Muon spans have different sizes");
+    }
+
+    // Figure out what needs to be done, just once for the whole batch.
+    const CalibSteps steps = calibSteps(syst);
+
+    // Calibrate all of the muons.
+    for (std::size_t i = 0; i < pt.size(); ++i) {
+        result[i] = applyCalibSteps(pt[i], eta[i], phi[i], steps);
+    }
+}
+
+void MuonCalibrator::getCalibratedPtVariations(float pt, float eta, float phi,
+                                               std::span<float> result) const {
+
+    // Do some sanity checks.
+    if (result.size() != m_recommendedSteps.size() + 1) {
+        throw std::invalid_argument("Wrong number of variations requested");
     }
 
-    /// Lambda checking if a muon falls in a specific @c CalibData range.
-    auto in_range = [eta, phi](const CalibData& calib, float pt) -> bool {
-        return (calib.min_eta <= eta && eta < calib.max_eta &&
-                calib.min_phi <= phi && phi < calib.max_phi &&
-                calib.min_pt <= pt && pt < calib.max_pt);
-    };
-
-    /// Lambda applying a calibration to a muon.
-    auto apply_calib = [&in_range, &pt, eta, phi](
-                           const std::vector<CalibData>& calibs,
-                           auto operation) -> void {
-        for (const auto& calib : calibs) {
-            if (in_range(calib, pt)) {
-                pt = operation(pt, calib.variation);
-                return;
+    // Apply the nominal calibration.
+    phi = wrapPhi(phi);
+    pt *= (1.f + m_nominal[findCalib(m_nominal, pt, eta, phi)].variation);
+    result[0] = pt;
+
+    // Derive the systematic variations from it.
+    for (std::size_t i = 0; i < m_recommendedSteps.size(); ++i) {
+        result[i + 1] = applyCalibSteps(pt, eta, phi, m_recommendedSteps[i]);
+    }
+}
+
+std::size_t MuonCalibrator::getCalibratedPtVariations(
+    std::span<const float> pt, std::span<const float> eta,
+    std::span<const float> phi, const std::vector<CP::SystematicSet>& syst,
+    std::span<const std::span<float> > result, float invalidPt) const {
+
+    // Do some sanity checks.
+    if ((pt.size() != eta.size()) || (pt.size() != phi.size())) {
+        throw std::invalid_argument("Muon spans have different sizes");
+    }
+    if (result.size() != syst.size() + 1) {
+        throw std::invalid_argument("Wrong number of variations requested");
+    }
+    for (std::span<float> r : result) {
+        if (r.size() != pt.size()) {
+            throw std::invalid_argument("Muon spans have different sizes");
+        }
+    }
+
+    // Figure out what needs to be done, just once for the whole batch.
+    const CalibSteps nominalSteps = calibSteps({});
+    std::vector<CalibSteps> variationSteps;
+    variationSteps.reserve(syst.size());
+    for (const CP::SystematicSet& s : syst) {
+        variationSteps.push_back(calibSteps(s, false));
+    }
+
+    // Calibrate all of the muons.
+    std::size_t nInvalid = 0;
+    for (std::size_t i = 0; i < pt.size(); ++i) {
+        // Apply the nominal calibration.
+        float nominal = pt[i];
+        bool valid = tryApplyCalibSteps(nominal, eta[i], phi[i], nominalSteps);
+        result[0][i] = nominal;
+        // Derive the systematic variations from it.
+        for (std::size_t j = 0; valid && (j < variationSteps.size()); ++j) {
+            float varied = nominal;
+            valid = tryApplyCalibSteps(varied, eta[i], phi[i],
+                                       variationSteps[j]);
+            result[j + 1][i] = varied;
+        }
+        // Flag the muon in all outputs if any of the steps failed for it.
+        if (!valid) {
+            for (std::span<float> r : result) {
+                r[i] = invalidPt;
             }
+            ++nInvalid;
         }
-        throw std::out_of_range("Muon out of range for calibration");
-    };
+    }
+    return nInvalid;
+}
+
+MuonCalibrator::CalibSteps MuonCalibrator::calibSteps(
+    const CP::SystematicSet& syst, bool nominal) const {
 
     // First, apply the "nominal calibration".
-    apply_calib(m_nominal, [](float pt, float variation) {
-        return pt * (1.f + variation);
-    });
+    CalibSteps result;
+    if (nominal) {
+        result.steps[result.size++] = {&MuonCalibrator::m_nominal, 1.f};
+    }
 
     // Then, apply the systematic variation(s).
     if (syst.find({"MUON_FOO", 1}) != syst.end()) {
-        apply_calib(m_foo, [](float pt, float variation) {
-            return pt * (1.f + variation);
-        });
+        result.steps[result.size++] = {&MuonCalibrator::m_foo, 1.f};
     }
     if (syst.find({"MUON_FOO", -1}) != syst.end()) {
-        apply_calib(m_foo, [](float pt, float variation) {
-            return pt * (1.f - variation);
-        });
+        result.steps[result.size++] = {&MuonCalibrator::m_foo, -1.f};
     }
     if (syst.find({"MUON_BAR", 1}) != syst.end()) {
-        apply_calib(m_bar, [](float pt, float variation) {
-            return pt * (1.f + variation);
-        });
+        result.steps[result.size++] = {&MuonCalibrator::m_bar, 1.f};
     }
     if (syst.find({"MUON_BAR", -1}) != syst.end()) {
-        apply_calib(m_bar, [](float pt, float variation) {
-            return pt * (1.f - variation);
-        });
+        result.steps[result.size++] = {&MuonCalibrator::m_bar, -1.f};
     }
+    return result;
+}
 
-    // Return the "calibrated" transverse momentum.
+void MuonCalibrator::getToyCalibratedPt(float pt, float eta, float phi,
+                                        std::uint32_t seed,
+                                        std::span<float> result) const {
+
+    // Get the nominal calibration.
+    phi = wrapPhi(phi);
+    const CalibData& nominal = m_nominal[findCalib(m_nominal, pt, eta, phi)];
+    pt *= (1.f + nominal.variation);
+
+    // Start all toys from the nominal calibration.
+    for (float& toy : result) {
+        toy = pt;
+    }
+
+    // Smear the toys with each systematic source. Every bin of every source
+    // gets its own random number stream. The loop over the toys is free of
+    // branches and of errno setting calls (this file is compiled with
+    // -fno-math-errno), so that the compiler could vectorize it.
+    std::uint32_t bin_offset = 0;
+    for (const std::vector<CalibData>* calibs : {&m_foo, &m_bar}) {
+        const std::size_t bin = findCalib(*calibs, pt, eta, phi);
+        const float variation = (*calibs)[bin].variation;
+        const std::uint32_t key1 =
+            mixBits(seed ^ mixBits(2 * (bin_offset + bin)));
+        const std::uint32_t key2 =
+            mixBits(seed ^ mixBits(2 * (bin_offset + bin) + 1));
+        const std::size_t n_toys = result.size();
+        for (std::size_t toy = 0; toy < n_toys; ++toy) {
+            const std::uint32_t counter =
+                static_cast<std::uint32_t>(toy) * 0x9e3779b9u;
+            // Two uniform random numbers in (0, 1), with 24 bits precision.
+            const float u1 =
+                ((mixBits(key1 + counter) >> 8) + 0.5f) * 0x1p-24f;
+            const float u2 =
+                ((mixBits(key2 + counter) >> 8) + 0.5f) * 0x1p-24f;
+            // A standard normal random number, using the Box-Muller method.
+            const float gauss =
+                std::sqrt(-2.f * logPositive(u1)) * cos2Pi(u2);
+            result[toy] *= (1.f + gauss * variation);
+        }
+        bin_offset += calibs->size();
+    }
+}
+
+float MuonCalibrator::wrapPhi(float phi) {
+
+    // Get phi into the -pi to pi range. Apparently reconstructed muons still
+    // have values outside of it sometimes. :-/
+    while (phi < -M_PI) {
+        phi += 2.f * M_PI;
+    }
+    while (phi >= M_PI) {
+        phi -= 2.f * M_PI;
+    }
+    return phi;
+}
+
+std::size_t MuonCalibrator::findCalib(const std::vector<CalibData>& calibs,
+                                      float pt, float eta, float phi) {
+
+    const std::size_t result = tryFindCalib(calibs, pt, eta, phi);
+    if (result == INVALID_BIN) {
+        throw std::out_of_range("Muon out of range for calibration");
+    }
+    return result;
+}
+
+std::size_t MuonCalibrator::tryFindCalib(
+    const std::vector<CalibData>& calibs, float pt, float eta, float phi) {
+
+    for (std::size_t i = 0; i < calibs.size(); ++i) {
+        const CalibData& calib = calibs[i];
+        if (calib.min_eta <= eta && eta < calib.max_eta &&
+            calib.min_phi <= phi && phi < calib.max_phi &&
+            calib.min_pt <= pt && pt < calib.max_pt) {
+            return i;
+        }
+    }
+    return INVALID_BIN;
+}
+
+float MuonCalibrator::applyCalibSteps(float pt, float eta, float phi,
+                                      const CalibSteps& steps) const {
+
+    if (!tryApplyCalibSteps(pt, eta, phi, steps)) {
+        throw std::out_of_range("Muon out of range for calibration");
+    }
     return pt;
 }
 
+bool MuonCalibrator::tryApplyCalibSteps(float& pt, float eta, float phi,
+                                        const CalibSteps& steps) const {
+
+    // Apply all of the steps, in order. Only modifying the transverse
+    // momentum if all of them succeed.
+    phi = wrapPhi(phi);
+    float result = pt;
+    for (std::size_t i = 0; i < steps.size; ++i) {
+        const CalibStep& step = steps.steps[i];
+        const std::vector<CalibData>& calibs = this->*(step.calibs);
+        const std::size_t bin = tryFindCalib(calibs, result, eta, phi);
+        if (bin == INVALID_BIN) {
+            return false;
+        }
+        result *= (1.f + step.sign * calibs[bin].variation);
+    }
+
+    // Return the "calibrated" transverse momentum.
+    pt = result;
+    return true;
+}
+
 }  // namespace ATE
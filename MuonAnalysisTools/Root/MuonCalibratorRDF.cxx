@@ -3,6 +3,12 @@
 // Local include(s).
 #include "MuonAnalysisTools/MuonCalibratorRDF.h"
 
+// ROOT include(s).
+#include <TList.h>
+#include <TObjArray.h>
+#include <TParameter.h>
+#include <TTree.h>
+
 // System include(s).
 #include <stdexcept>
 
@@ -66,7 +72,7 @@ ROOT::RVec<std::vector<float> > MuonVariator::operator()(
         result[i].reserve(pt.size());
         for (std::size_t j = 0; j < pt.size(); ++j) {
             result[i].push_back(
-                getCalibratedPt(pt[j], eta[i], phi[i], {*syst_it}));
+                getCalibratedPt(pt[j], eta[j], phi[j], {*syst_it}));
         }
     }
 
@@ -96,4 +102,159 @@ ROOT::RVec<std::vector<float> > MuonVariatorxAOD::operator()(
     return result;
 }
 
+ROOT::RVec<std::vector<float> > MuonCalibratorVariator::operator()(
+    const std::vector<float>& pt, const std::vector<float>& eta,
+    const std::vector<float>& phi) const {
+
+    // Do some sanity checks.
+    if ((pt.size() != eta.size()) || (pt.size() != phi.size())) {
+        throw std::invalid_argument("Muon vectors have different sizes");
+    }
+
+    // Create the output vector.
+    const std::size_t n_variations = m_recommendedSystematics.size() + 1;
+    ROOT::RVec<std::vector<float> > result(n_variations);
+    for (std::vector<float>& variation : result) {
+        variation.resize(pt.size());
+    }
+
+    // Fill it, calibrating each muon just once.
+    std::vector<float> variations(n_variations);
+    for (std::size_t i = 0; i < pt.size(); ++i) {
+        getCalibratedPtVariations(pt[i], eta[i], phi[i], variations);
+        for (std::size_t j = 0; j < n_variations; ++j) {
+            result[j][i] = variations[j];
+        }
+    }
+
+    // Return it.
+    return result;
+}
+
+ROOT::RVec<std::vector<float> > MuonCalibratorVariatorxAOD::operator()(
+    const xAOD::MuonContainer& muons) const {
+
+    // Create the output vector.
+    const std::size_t n_variations = m_recommendedSystematics.size() + 1;
+    ROOT::RVec<std::vector<float> > result(n_variations);
+    for (std::vector<float>& variation : result) {
+        variation.resize(muons.size());
+    }
+
+    // Fill it, calibrating each muon just once.
+    std::vector<float> variations(n_variations);
+    std::size_t i = 0;
+    for (const xAOD::Muon* muon : muons) {
+        getCalibratedPtVariations(muon->pt(), muon->eta(), muon->phi(),
+                                  variations);
+        for (std::size_t j = 0; j < n_variations; ++j) {
+            result[j][i] = variations[j];
+        }
+        ++i;
+    }
+
+    // Return it.
+    return result;
+}
+
+MuonToyVariator::MuonToyVariator(std::size_t nToys, std::uint32_t seed,
+                                 const std::string& name)
+    : ATE::MuonCalibrator(name), m_nToys(nToys), m_seed(seed) {}
+
+ROOT::RVec<std::vector<float> > MuonToyVariator::operator()(
+    const std::vector<float>& pt, const std::vector<float>& eta,
+    const std::vector<float>& phi) const {
+
+    // Do some sanity checks.
+    if ((pt.size() != eta.size()) || (pt.size() != phi.size())) {
+        throw std::invalid_argument("Muon vectors have different sizes");
+    }
+
+    // Create the output vector.
+    ROOT::RVec<std::vector<float> > result(m_nToys);
+    for (std::vector<float>& toy : result) {
+        toy.resize(pt.size());
+    }
+
+    // Fill it, evaluating all toys for one muon at a time.
+    std::vector<float> toys(m_nToys);
+    for (std::size_t i = 0; i < pt.size(); ++i) {
+        getToyCalibratedPt(pt[i], eta[i], phi[i], m_seed, toys);
+        for (std::size_t j = 0; j < m_nToys; ++j) {
+            result[j][i] = toys[j];
+        }
+    }
+
+    // Return it.
+    return result;
+}
+
+MuonToyVariatorxAOD::MuonToyVariatorxAOD(std::size_t nToys,
+                                         std::uint32_t seed,
+                                         const std::string& name)
+    : ATE::MuonCalibrator(name), m_nToys(nToys), m_seed(seed) {}
+
+ROOT::RVec<std::vector<float> > MuonToyVariatorxAOD::operator()(
+    const xAOD::MuonContainer& muons) const {
+
+    // Create the output vector.
+    ROOT::RVec<std::vector<float> > result(m_nToys);
+    for (std::vector<float>& toy : result) {
+        toy.resize(muons.size());
+    }
+
+    // Fill it, evaluating all toys for one muon at a time.
+    std::vector<float> toys(m_nToys);
+    std::size_t i = 0;
+    for (const xAOD::Muon* muon : muons) {
+        getToyCalibratedPt(muon->pt(), muon->eta(), muon->phi(), m_seed,
+                           toys);
+        for (std::size_t j = 0; j < m_nToys; ++j) {
+            result[j][i] = toys[j];
+        }
+        ++i;
+    }
+
+    // Return it.
+    return result;
+}
+
+std::vector<float> MuonVariationDecoder::operator()(
+    const std::vector<float>& nominal,
+    const std::vector<value_type>& delta) const {
+
+    std::vector<float> result(nominal.size());
+    decode(nominal, delta, result);
+    return result;
+}
+
+EncodedVariations findEncodedVariations(TTree& tree,
+                                        const std::string& column) {
+
+    // Look up the precision of the encoding.
+    const std::string precisionName = column + "_delta_precision";
+    const auto* precision = dynamic_cast<const TParameter<float>*>(
+        tree.GetUserInfo()->FindObject(precisionName.c_str()));
+    if (precision == nullptr) {
+        throw std::runtime_error("No \"" + precisionName +
+                                 "\" parameter found in tree \"" +
+                                 tree.GetName() + "\"");
+    }
+    EncodedVariations result;
+    result.precision = precision->GetVal();
+
+    // Collect the names of the encoded variations.
+    const std::string prefix = column + "_";
+    const std::string postfix = "_delta";
+    for (const TObject* branch : *(tree.GetListOfBranches())) {
+        const std::string name = branch->GetName();
+        if ((name.size() > prefix.size() + postfix.size()) &&
+            name.starts_with(prefix) && name.ends_with(postfix)) {
+            result.names.push_back(name.substr(
+                prefix.size(), name.size() - prefix.size() - postfix.size()));
+        }
+    }
+    return result;
+}
+
 }  // namespace ATE::RDF
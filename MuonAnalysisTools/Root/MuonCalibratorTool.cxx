@@ -7,12 +7,63 @@
 #include <AsgMessaging/MessageCheck.h>
 
 // System include(s).
-#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+
+namespace {
+
+/// Counter used to give a unique identifier to every tool instance
+std::atomic<std::size_t> s_toolCounter{0};
+
+/// Pseudorapidity region boundaries for the out-of-validity bookkeeping
+constexpr std::array<float, 5> ETA_EDGES = {-5.f, -2.5f, 0.f, 2.5f, 5.f};
+/// Transverse momentum region boundaries for the out-of-validity bookkeeping
+constexpr std::array<float, 4> PT_EDGES = {0.f, 1e4f, 1e5f, 1e6f};
+
+/// Find the region of a value, given the boundaries of the regions
+template <std::size_t N>
+std::size_t findRegion(const std::array<float, N> &edges, float value) {
+    return std::upper_bound(edges.begin(), edges.end(), value) - edges.begin();
+}
+
+/// Get a printable description of a region
+template <std::size_t N>
+std::string regionName(const std::array<float, N> &edges, std::size_t i) {
+    std::ostringstream result;
+    result << "[";
+    if (i == 0) {
+        result << "-inf";
+    } else {
+        result << edges[i - 1];
+    }
+    result << ", ";
+    if (i == N) {
+        result << "inf";
+    } else {
+        result << edges[i];
+    }
+    result << ")";
+    return result.str();
+}
+
+}  // namespace
 
 namespace ATE {
 
 MuonCalibratorTool::MuonCalibratorTool(const std::string &name)
-    : asg::AsgTool(name), m_calibrator(this->name()) {}
+    : asg::AsgTool(name),
+      m_id(s_toolCounter++),
+      m_calibrator(this->name()) {}
+
+#ifdef XAOD_STANDALONE
+MuonCalibratorTool::~MuonCalibratorTool() {
+
+    printOutOfValiditySummary();
+}
+#endif  // XAOD_STANDALONE
 
 StatusCode MuonCalibratorTool::initialize() {
 
@@ -30,24 +81,32 @@ StatusCode MuonCalibratorTool::initialize() {
     return StatusCode::SUCCESS;
 }
 
+#ifndef XAOD_STANDALONE
+StatusCode MuonCalibratorTool::finalize() {
+
+    // Print the summary while the message service is still available.
+    printOutOfValiditySummary();
+
+    // Return gracefully.
+    return StatusCode::SUCCESS;
+}
+#endif  // not XAOD_STANDALONE
+
 CP::CorrectionCode MuonCalibratorTool::applyCalibration(
     xAOD::Muon &muon) const {
 
-    // Check for errors during the calibration. Only looking for out of range
-    // errors. Everything else is allowed to make its way to a higher level.
-    try {
-        // Set the calibrated transverse momentum on the muon.
-        muon.setP4(m_calibrator.getCalibratedPt(muon.pt(), muon.eta(),
-                                                muon.phi(), m_syst),
-                   muon.eta(), muon.phi());
-    } catch (const std::out_of_range &) {
-        ATH_MSG_WARNING("Muon is outside of validity range: "
-                        << "pt = " << muon.pt() << ", "
-                        << "eta = " << muon.eta() << ", "
-                        << "phi = " << muon.phi());
+    // Calibrate the muon, using the non-throwing interface of the
+    // calibrator, as out-of-validity muons are not rare at all.
+    float pt = 0.f;
+    if (!m_calibrator.tryGetCalibratedPt(muon.pt(), muon.eta(), muon.phi(),
+                                         pt, m_syst)) {
+        recordOutOfValidity(muon);
         return CP::CorrectionCode::OutOfValidityRange;
     }
 
+    // Set the calibrated transverse momentum on the muon.
+    muon.setP4(pt, muon.eta(), muon.phi());
+
     // Return gracefully.
     return CP::CorrectionCode::Ok;
 }
@@ -67,6 +126,111 @@ CP::CorrectionCode MuonCalibratorTool::applyCalibration(
     return CP::CorrectionCode::Ok;
 }
 
+void MuonCalibratorTool::recordOutOfValidity(const xAOD::Muon &muon) const {
+
+    // Count the muon in its region, without any locking.
+    const float phi = std::remainder(muon.phi(), 2.f * float(M_PI));
+    const std::size_t eta_region = findRegion(ETA_EDGES, muon.eta());
+    const std::size_t phi_region = std::min(
+        N_PHI_REGIONS - 1,
+        static_cast<std::size_t>(std::max(
+            0.f, std::floor((phi + float(M_PI)) / (0.5f * float(M_PI))))));
+    const std::size_t pt_region = findRegion(PT_EDGES, muon.pt());
+    ++outOfValidityCounts().counts[(eta_region * N_PHI_REGIONS + phi_region) *
+                                       N_PT_REGIONS +
+                                   pt_region];
+
+    // Print a detailed warning for the first couple of muons only, and a
+    // note about suppressing any further ones after the last of those (or
+    // for the very first muon, if no detailed warnings were requested).
+    // Every counter value is returned by exactly one increment, so the note
+    // is printed exactly once, whichever thread would be the one to print it.
+    const unsigned int maxWarnings = m_maxDetailedWarnings;
+    const unsigned int lastWarning = std::max(maxWarnings, 1u) - 1;
+    if (m_nDetailedWarnings.load(std::memory_order_relaxed) > lastWarning) {
+        return;
+    }
+    const unsigned int nWarnings = m_nDetailedWarnings++;
+    if (nWarnings < maxWarnings) {
+        ATH_MSG_WARNING("Muon is outside of validity range: "
+                        << "pt = " << muon.pt() << ", "
+                        << "eta = " << muon.eta() << ", "
+                        << "phi = " << muon.phi());
+    }
+    if (nWarnings == lastWarning) {
+        ATH_MSG_WARNING("Suppressing further out-of-validity warnings. "
+                        "A summary will be printed at the end of the job.");
+    }
+}
+
+MuonCalibratorTool::OutOfValidityCounts &
+MuonCalibratorTool::outOfValidityCounts() const {
+
+    // Look for the counts of the current thread in a thread-local cache
+    // first, to only lock the mutex the first time that a thread would need
+    // them.
+    thread_local std::unordered_map<std::size_t, OutOfValidityCounts *> cache;
+    auto itr = cache.find(m_id);
+    if (itr != cache.end()) {
+        return *(itr->second);
+    }
+    std::lock_guard lock{m_outOfValidityMutex};
+    m_outOfValidityCounts.push_back(std::make_unique<OutOfValidityCounts>());
+    cache[m_id] = m_outOfValidityCounts.back().get();
+    return *(m_outOfValidityCounts.back());
+}
+
+void MuonCalibratorTool::printOutOfValiditySummary() const {
+
+    // Only print the summary once.
+    std::lock_guard lock{m_outOfValidityMutex};
+    if (m_outOfValiditySummaryPrinted) {
+        return;
+    }
+    m_outOfValiditySummaryPrinted = true;
+
+    // Sum up the counts from all threads.
+    OutOfValidityCounts total;
+    for (const std::unique_ptr<OutOfValidityCounts> &counts :
+         m_outOfValidityCounts) {
+        for (std::size_t i = 0; i < total.counts.size(); ++i) {
+            total.counts[i] += counts->counts[i];
+        }
+    }
+
+    // Print a table for the regions with any out-of-validity muons.
+    std::uint64_t sum = 0;
+    std::ostringstream table;
+    table << "\n  " << std::left << std::setw(22) << "eta" << std::setw(22)
+          << "phi" << std::setw(30) << "pt [MeV]" << "muons";
+    for (std::size_t eta = 0; eta < N_ETA_REGIONS; ++eta) {
+        for (std::size_t phi = 0; phi < N_PHI_REGIONS; ++phi) {
+            for (std::size_t pt = 0; pt < N_PT_REGIONS; ++pt) {
+                const std::uint64_t count =
+                    total.counts[(eta * N_PHI_REGIONS + phi) * N_PT_REGIONS +
+                                 pt];
+                if (count == 0) {
+                    continue;
+                }
+                sum += count;
+                std::ostringstream phi_name;
+                phi_name << std::fixed << std::setprecision(2) << "["
+                         << (phi * 0.5 - 1.) * M_PI << ", "
+                         << ((phi + 1) * 0.5 - 1.) * M_PI << ")";
+                table << "\n  " << std::setw(22)
+                      << regionName(ETA_EDGES, eta) << std::setw(22)
+                      << phi_name.str() << std::setw(30)
+                      << regionName(PT_EDGES, pt) << count;
+            }
+        }
+    }
+    if (sum == 0) {
+        return;
+    }
+    ATH_MSG_WARNING(sum << " muon(s) were outside of the validity range:"
+                        << table.str());
+}
+
 StatusCode MuonCalibratorTool::sysApplySystematicVariation(
     const CP::SystematicSet &syst) {
 
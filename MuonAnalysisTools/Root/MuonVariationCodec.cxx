@@ -0,0 +1,76 @@
+// Copyright (C) 2002-2024 CERN for the benefit of the ATLAS collaboration
+
+// Local include(s).
+#include "MuonAnalysisTools/MuonVariationCodec.h"
+
+// System include(s).
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace ATE {
+
+MuonVariationCodec::MuonVariationCodec(float precision)
+    : m_precision(precision) {
+
+    if (!(m_precision > 0.f)) {
+        throw std::invalid_argument(
+            "Variation encoding precision must be positive");
+    }
+}
+
+void MuonVariationCodec::encode(std::span<const float> nominal,
+                                std::span<const float> varied,
+                                std::span<value_type> delta) const {
+
+    // Do some sanity checks.
+    if ((nominal.size() != varied.size()) ||
+        (nominal.size() != delta.size())) {
+        throw std::invalid_argument("Muon spans have different sizes");
+    }
+
+    // The range of values that can be stored.
+    static constexpr float min_delta =
+        std::numeric_limits<value_type>::min();
+    static constexpr float max_delta =
+        std::numeric_limits<value_type>::max();
+
+    // Encode the variations.
+    for (std::size_t i = 0; i < nominal.size(); ++i) {
+        // Take care of muons without a (nominal) momentum.
+        if (nominal[i] == 0.f) {
+            if (varied[i] != 0.f) {
+                throw std::out_of_range(
+                    "Can't encode a variation of a zero momentum");
+            }
+            delta[i] = 0;
+            continue;
+        }
+        // Encode the relative difference.
+        const float d =
+            std::round((varied[i] / nominal[i] - 1.f) / m_precision);
+        if (!((min_delta <= d) && (d <= max_delta))) {
+            throw std::out_of_range(
+                "Variation too large to encode with the requested precision");
+        }
+        delta[i] = static_cast<value_type>(d);
+    }
+}
+
+void MuonVariationCodec::decode(std::span<const float> nominal,
+                                std::span<const value_type> delta,
+                                std::span<float> varied) const {
+
+    // Do some sanity checks.
+    if ((nominal.size() != delta.size()) ||
+        (nominal.size() != varied.size())) {
+        throw std::invalid_argument("Muon spans have different sizes");
+    }
+
+    // Decode the variations.
+    for (std::size_t i = 0; i < nominal.size(); ++i) {
+        varied[i] = nominal[i] * (1.f + delta[i] * m_precision);
+    }
+}
+
+}  // namespace ATE